@@ -9,10 +9,29 @@
 #include <sys/time.h>
 #include <string.h>
 #include <math.h>
+#include <spawn.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/wait.h>
 #include "timefunctions.h"
+#include "registry.h"
+
+extern char **environ;
 
 void usage(char* msg){
-	fprintf(stderr, "Usage: countdown [ NUMBER[SUFFIX]... | POINT_IN_TIME ]\n");
+	fprintf(stderr, "Usage: countdown [OPTIONS] [ NUMBER[SUFFIX]... | POINT_IN_TIME ]\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "OPTIONS:\n");
+	fprintf(stderr, "  --exec CMD        run the shell command CMD when the countdown ends, and exit with its status\n");
+	fprintf(stderr, "  --exec-argv PROG [ARG]...\n");
+	fprintf(stderr, "                    like --exec, but run PROG with the ARGs (all remaining arguments) without a shell\n");
+	fprintf(stderr, "  --exec-before MS  start a waiting process for the command MS milliseconds before the end (default 1000);\n");
+	fprintf(stderr, "                    at the end it only has to exec the command\n");
+	fprintf(stderr, "  --stats           print how late the end was noticed and the release latency of the command: how late\n");
+	fprintf(stderr, "                    the waiting process was woken; the command is started by its exec after that\n");
+	fprintf(stderr, "  --label TEXT      show TEXT for this countdown in --list (default: the arguments)\n");
+	fprintf(stderr, "  --list            print the running countdowns of the current user, one per line:\n");
+	fprintf(stderr, "                    pid, end in seconds since the Epoch, remaining seconds and label, separated by tabs\n");
 	fprintf(stderr, "\n");
 	fprintf(stderr, "SUFFIX may be one of:\n");
 	fprintf(stderr, "'s' or no suffix for seconds,\n");
@@ -25,6 +44,8 @@ void usage(char* msg){
 	fprintf(stderr, "\n");
 	fprintf(stderr, "Example 1: countdown 1.5m 3s\n");
 	fprintf(stderr, "Example 2: countdown 16:4\n");
+	fprintf(stderr, "Example 3: countdown --exec './action' 16:4\n");
+	fprintf(stderr, "Example 4: countdown 16:4 --exec-argv ./action --now\n");
 	if (msg != NULL) {
 		fprintf(stderr, "\nError: %s\n", msg);
 	}
@@ -64,7 +85,130 @@ int parse_duration(int argc, char** argv, double* seconds) {
 	return 1;
 }
 
+/* Spawn a shell which execs `exec_argv` (a NULL-terminated argument vector) as soon as a byte is written to `*release_fd`, or which exits with status 125 if `*release_fd` is closed without writing, e.g. if countdown is killed. Nothing is forked after the release. */
+pid_t spawn_blocked(char *const *exec_argv, int *release_fd) {
+	int fds[2];
+	if (pipe(fds) == -1) {
+		perror("pipe error");
+		exit(2);
+	}
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_adddup2(&actions, fds[0], 3);
+	posix_spawn_file_actions_addclose(&actions, fds[1]);
+	if (fds[0] != 3)
+		posix_spawn_file_actions_addclose(&actions, fds[0]);
+
+	const char *script = "read -r release <&3 || exit 125; exec 3<&- \"$@\"";
+	int exec_argc = 0;
+	while (exec_argv[exec_argc] != NULL) exec_argc++;
+	char *spawn_argv[exec_argc + 5];
+	spawn_argv[0] = "sh";
+	spawn_argv[1] = "-c";
+	spawn_argv[2] = (char*)script;
+	spawn_argv[3] = "countdown";
+	for (int i = 0; i <= exec_argc; i++) {
+		spawn_argv[4 + i] = exec_argv[i];
+	}
+	pid_t pid;
+	int err = posix_spawn(&pid, "/bin/sh", &actions, NULL, spawn_argv, environ);
+	if (err != 0) {
+		fprintf(stderr, "posix_spawn error: %s\n", strerror(err));
+		exit(2);
+	}
+	posix_spawn_file_actions_destroy(&actions);
+	close(fds[0]);
+	*release_fd = fds[1];
+	return pid;
+}
+
+/* Print the running countdowns as described in `usage`. Reads only the registry, not the countdown processes. */
+void list_countdowns() {
+	registry *reg = registry_open(0);
+	if (reg == NULL)
+		return;
+	struct timeval tv_now;
+	if (gettimeofday(&tv_now, NULL) == -1) {
+		perror("gettimeofday error");
+		exit(2);
+	}
+	for (int slot = 0; slot < REGISTRY_SLOTS; slot++) {
+		registry_slot copy;
+		if (!registry_read(reg, slot, &copy))
+			continue;
+		long long rem = copy.stop_sec - tv_now.tv_sec;
+		// countdowns remove themselves at their end, so this one was killed.
+		if (rem < 0)
+			continue;
+		printf("%i\t%lld\t%lld\t%s\n", copy.pid, copy.stop_sec, rem, copy.label);
+	}
+}
+
+registry *countdown_registry = NULL;
+int countdown_slot = -1;
+
+void unregister_and_raise(int sig) {
+	registry_unregister(countdown_registry, countdown_slot);
+	signal(sig, SIG_DFL);
+	raise(sig);
+}
+
+double timeval_to_seconds(const struct timeval *tv) {
+	return tv->tv_sec + (double)tv->tv_usec / 1000000;
+}
+
 int main(int argc, char** argv) {
+	char *const *exec_argv = NULL;
+	char *exec_shell_argv[] = {"/bin/sh", "-c", NULL, NULL};
+	double exec_before = 1.0;
+	int stats = 0;
+	char label[REGISTRY_LABEL_SIZE] = "";
+	{
+		// remove the options from `argv`.
+		int args_num = 1;
+		for (int i=1; i<argc; i++) {
+			int has_value = i+1 < argc;
+			if ((strcmp(argv[i], "--exec") == 0 || strcmp(argv[i], "--exec-argv") == 0 || strcmp(argv[i], "--exec-before") == 0 || strcmp(argv[i], "--label") == 0) && !has_value) {
+				usage(NULL);
+				fprintf(stderr, "\nError: %s needs an argument\n", argv[i]);
+				exit(1);
+			}
+			if (strcmp(argv[i], "--exec") == 0) {
+				exec_shell_argv[2] = argv[++i];
+				exec_argv = exec_shell_argv;
+			} else if (strcmp(argv[i], "--exec-argv") == 0) {
+				// all remaining arguments (`argv` is NULL-terminated).
+				exec_argv = &argv[i+1];
+				break;
+			} else if (strcmp(argv[i], "--exec-before") == 0) {
+				char *endptr;
+				double ms = strtod(argv[++i], &endptr);
+				if (endptr == argv[i] || *endptr != '\0' || !(ms >= 0)) {
+					usage("--exec-before needs a number of milliseconds >= 0");
+					exit(1);
+				}
+				exec_before = ms / 1000;
+			} else if (strcmp(argv[i], "--stats") == 0) {
+				stats = 1;
+			} else if (strcmp(argv[i], "--label") == 0) {
+				strncpy(label, argv[++i], REGISTRY_LABEL_SIZE - 1);
+			} else if (strcmp(argv[i], "--list") == 0) {
+				list_countdowns();
+				exit(0);
+			} else {
+				argv[args_num++] = argv[i];
+			}
+		}
+		argc = args_num;
+	}
+	if (label[0] == '\0') {
+		for (int i=1; i<argc; i++) {
+			if (i > 1)
+				strncat(label, " ", REGISTRY_LABEL_SIZE - 1 - strlen(label));
+			strncat(label, argv[i], REGISTRY_LABEL_SIZE - 1 - strlen(label));
+		}
+	}
+
 	if (argc < 2) {
 		usage("need at least one number");
 		exit(1);
@@ -145,6 +289,39 @@ int main(int argc, char** argv) {
 		buf_stop[strlen(buf_stop)-1] = '\0';
 	}
 	
+	// publish `tv_stop` in the registry. Signals are blocked, so that the handler does not run while the slot is written.
+	countdown_registry = registry_open(1);
+	if (countdown_registry != NULL) {
+		sigset_t signals, old_signals;
+		sigemptyset(&signals);
+		sigaddset(&signals, SIGINT);
+		sigaddset(&signals, SIGTERM);
+		sigaddset(&signals, SIGHUP);
+		sigprocmask(SIG_BLOCK, &signals, &old_signals);
+		countdown_slot = registry_register(countdown_registry, &tv_stop, label);
+		if (countdown_slot != -1) {
+			struct sigaction action;
+			memset(&action, 0, sizeof(action));
+			action.sa_handler = unregister_and_raise;
+			sigaction(SIGINT, &action, NULL);
+			sigaction(SIGTERM, &action, NULL);
+			sigaction(SIGHUP, &action, NULL);
+		}
+		sigprocmask(SIG_SETMASK, &old_signals, NULL);
+	}
+
+	// the time at which the shell for `exec_argv` is (or was) spawned.
+	struct timeval tv_spawn;
+	{
+		struct timeval tv_before;
+		tv_before.tv_sec = (int)floor(exec_before);
+		tv_before.tv_usec = (int)((exec_before - tv_before.tv_sec) * 1000000);
+		timersub(&tv_stop, &tv_before, &tv_spawn);
+	}
+	pid_t exec_pid = 0;
+	int release_fd = -1;
+
+	struct timeval tv_end; // when the end was noticed
 	while(1) {
 		struct timeval tv_now;
 		if (gettimeofday(&tv_now, NULL) == -1) {
@@ -152,11 +329,25 @@ int main(int argc, char** argv) {
 			exit(2);
 		}
 		if (!timercmp(&tv_now, &tv_stop, <)) {
+			tv_end = tv_now;
 			break;
 		}
+
+		if (exec_argv != NULL && exec_pid == 0 && !timercmp(&tv_now, &tv_spawn, <)) {
+			exec_pid = spawn_blocked(exec_argv, &release_fd);
+			tv_spawn = tv_now;
+		}
 		
 		struct timeval tv_rem; // remaining
 		timersub(&tv_stop, &tv_now, &tv_rem);
+
+		// wake up at the next full second before `tv_stop`, or when `exec_argv` must be spawned.
+		struct timeval tv_next;
+		tv_next.tv_sec = tv_stop.tv_sec - tv_rem.tv_sec;
+		tv_next.tv_usec = tv_stop.tv_usec;
+		if (exec_argv != NULL && exec_pid == 0 && timercmp(&tv_spawn, &tv_next, <)) {
+			tv_next = tv_spawn;
+		}
 		
 		tv_rem.tv_sec += 1; //we're waiting 1s after printing, not before
 		
@@ -167,14 +358,62 @@ int main(int argc, char** argv) {
 		printf("\r%i seconds (%i d %2i h %2i m %2i s) until %s", tv_rem.tv_sec, d_rem, h_rem, m_rem, s_rem, buf_stop);
 		fflush(stdout);
 		
-		if (usleep(1000000) == -1) {
-			perror("usleep error");
-			exit(2);
-		}
+		sleep_until(&tv_next);
 	}
-	
+
+	if (countdown_slot != -1) {
+		signal(SIGINT, SIG_DFL);
+		signal(SIGTERM, SIG_DFL);
+		signal(SIGHUP, SIG_DFL);
+		registry_unregister(countdown_registry, countdown_slot);
+	}
+
+	// print the last line before the command is released, so that its output does not end up in this line.
 	printf("\r0 seconds (0 d  0 h  0 m  0 s) until %s", buf_stop);
 	printf("\n");
+	fflush(stdout);
+
+	struct timeval tv_release;
+	if (exec_argv != NULL) {
+		if (exec_pid == 0) {
+			exec_pid = spawn_blocked(exec_argv, &release_fd);
+			tv_spawn = tv_end;
+		}
+		// a waiter which died (e.g. was killed) must not kill countdown by SIGPIPE. it is only ignored now, since the waiter would inherit it.
+		signal(SIGPIPE, SIG_IGN);
+		if (write(release_fd, "\n", 1) != 1) {
+			if (errno == EPIPE) {
+				fprintf(stderr, "Error: command waiter died before the command was started\n");
+			} else {
+				perror("write error");
+			}
+			exit(2);
+		}
+		if (gettimeofday(&tv_release, NULL) == -1) {
+			perror("gettimeofday error");
+			exit(2);
+		}
+		close(release_fd);
+	}
+
+	if (stats) {
+		printf("end noticed %.3f ms after %s\n", (timeval_to_seconds(&tv_end) - timeval_to_seconds(&tv_stop)) * 1000, buf_stop);
+		if (exec_argv != NULL) {
+			printf("command spawned %.3f ms before the end, release latency %.3f ms\n", (timeval_to_seconds(&tv_stop) - timeval_to_seconds(&tv_spawn)) * 1000, (timeval_to_seconds(&tv_release) - timeval_to_seconds(&tv_stop)) * 1000);
+		}
+		fflush(stdout);
+	}
+
+	if (exec_argv != NULL) {
+		int status;
+		if (waitpid(exec_pid, &status, 0) == -1) {
+			perror("waitpid error");
+			exit(2);
+		}
+		if (WIFEXITED(status))
+			return WEXITSTATUS(status);
+		return 128 + WTERMSIG(status);
+	}
 	
 	return 0;
 }
@@ -0,0 +1,98 @@
+#define _DEFAULT_SOURCE //kill, ftruncate
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include "registry.h"
+
+/* Open the registry of the current user. If `writable`, the registry is created if it does not exist yet. Returns NULL if the registry does not exist or cannot be opened. */
+registry *registry_open(int writable) {
+	char name[64];
+	snprintf(name, sizeof(name), "/countdown-registry-%u", (unsigned int)getuid());
+	int fd = shm_open(name, writable ? O_RDWR | O_CREAT : O_RDONLY, 0600);
+	if (fd == -1) {
+		if (errno != ENOENT)
+			perror("shm_open error");
+		return NULL;
+	}
+	struct stat st;
+	if (fstat(fd, &st) == -1) {
+		perror("fstat error");
+		close(fd);
+		return NULL;
+	}
+	if (st.st_size < (off_t)sizeof(registry)) {
+		// a new registry is zero-filled, i.e. all slots are free.
+		if (!writable || ftruncate(fd, sizeof(registry)) == -1) {
+			if (writable)
+				perror("ftruncate error");
+			close(fd);
+			return NULL;
+		}
+	}
+	void *ptr = mmap(NULL, sizeof(registry), writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (ptr == MAP_FAILED) {
+		perror("mmap error");
+		return NULL;
+	}
+	return (registry*)ptr;
+}
+
+/* Write `pid`, `tv_stop` and `label` into `slot` of `reg`, which must be owned by the calling process. */
+void registry_write(registry *reg, int slot, int pid, const struct timeval *tv_stop, const char *label) {
+	registry_slot *s = &reg->slots[slot];
+	// make `seq` odd, even if a previous owner died while writing.
+	s->seq |= 1;
+	__sync_synchronize();
+	s->pid = pid;
+	s->stop_sec = tv_stop ? tv_stop->tv_sec : 0;
+	s->stop_usec = tv_stop ? tv_stop->tv_usec : 0;
+	memset(s->label, 0, REGISTRY_LABEL_SIZE);
+	if (label)
+		strncpy(s->label, label, REGISTRY_LABEL_SIZE - 1);
+	__sync_synchronize();
+	s->seq++;
+}
+
+/* Publish a countdown ending at `tv_stop` with `label` in a free slot of `reg`. Slots of processes which do not exist anymore are reused. Returns the slot, or -1 if all slots are in use. */
+int registry_register(registry *reg, const struct timeval *tv_stop, const char *label) {
+	int pid = getpid();
+	for (int slot = 0; slot < REGISTRY_SLOTS; slot++) {
+		int owner = reg->slots[slot].owner;
+		if (owner != 0 && !(kill(owner, 0) == -1 && errno == ESRCH))
+			continue;
+		if (__sync_bool_compare_and_swap(&reg->slots[slot].owner, owner, pid)) {
+			registry_write(reg, slot, pid, tv_stop, label);
+			return slot;
+		}
+	}
+	return -1;
+}
+
+/* Remove the countdown in `slot` of `reg`. Only writes to memory, so it may be called from a signal handler. */
+void registry_unregister(registry *reg, int slot) {
+	registry_write(reg, slot, 0, NULL, NULL);
+	__sync_synchronize();
+	reg->slots[slot].owner = 0;
+}
+
+/* Copy `slot` of `reg` consistently into `copy`, without locking. Returns 1 if a countdown is published in the slot, and 0 otherwise (also if the slot could not be read consistently, e.g. because its owner died while writing it). */
+int registry_read(const registry *reg, int slot, registry_slot *copy) {
+	const registry_slot *s = &reg->slots[slot];
+	for (int tries = 0; tries < 1000; tries++) {
+		unsigned int seq = s->seq;
+		__sync_synchronize();
+		memcpy(copy, (const void*)s, sizeof(*copy));
+		__sync_synchronize();
+		if (!(seq & 1) && seq == s->seq)
+			return copy->pid != 0;
+	}
+	return 0;
+}
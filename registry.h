@@ -0,0 +1,21 @@
+/* A registry of running countdowns in shared memory. Every countdown publishes its end and label in a slot, and any process can read all slots without involving the countdowns. */
+#define REGISTRY_SLOTS 4096
+#define REGISTRY_LABEL_SIZE 64
+
+typedef struct registry_slot_struct {
+	volatile int owner;	// pid of the process which claimed the slot, 0 if the slot is free
+	volatile unsigned int seq;	// seqlock: odd while the fields below are written
+	int pid;	// 0 if no countdown is published in the slot
+	long long stop_sec;	// end of the countdown
+	long long stop_usec;
+	char label[REGISTRY_LABEL_SIZE];
+} registry_slot;
+
+typedef struct registry_struct {
+	registry_slot slots[REGISTRY_SLOTS];
+} registry;
+
+registry *registry_open(int writable);
+int registry_register(registry *reg, const struct timeval *tv_stop, const char *label);
+void registry_unregister(registry *reg, int slot);
+int registry_read(const registry *reg, int slot, registry_slot *copy);
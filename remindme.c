@@ -2,14 +2,23 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <pthread.h>
 #include "timefunctions.h"
+#include "stringpool.h"
 
 int verbose_parsing = 0;
 
-void usage(char *msg) {
+void usage(const char *msg) {
 	if (!verbose_parsing) {
 		fprintf(stderr, "Usage: [OPTIONS] DATESFILE\n");
+		fprintf(stderr, "       --check DATESFILE...\n");
 		fprintf(stderr, "\n");
 		fprintf(stderr, "OPTIONS:\n");
 		fprintf(stderr, "  -u  output reminders in the order in DATESFILE (sorting by date is default)\n");
@@ -19,6 +28,12 @@ void usage(char *msg) {
 		fprintf(stderr, "  -p  verbose parsing of DATESFILE (for debugging DATES)\n");
 		fprintf(stderr, "  -d  enable debugging output\n");
 		fprintf(stderr, "  -h  print this help\n");
+		fprintf(stderr, "  --format=FORMAT  output reminders as machine-readable records (FORMAT is 'tsv', 'jsonl' or 'binary')\n");
+		fprintf(stderr, "  --watch  keep running and print an update exactly when the output changes: a line '=N' with the\n");
+		fprintf(stderr, "           new number N of lines, followed by 'I<TAB>LINE' for each line I (from 1) which changed;\n");
+		fprintf(stderr, "           exits when the output cannot change anymore; cannot be combined with --format\n");
+		fprintf(stderr, "  --check  only check the DATESFILEs (in parallel) and print all errors with their line and column;\n");
+		fprintf(stderr, "           cannot be combined with --watch or --format\n");
 		fprintf(stderr, "\n");
 		fprintf(stderr, "DATESFILE must contain one or multiple 'DATE / MESSAGE' lines.\n");
 		fprintf(stderr, "It may also contain comments starting with '#' and extending to the end of line.\n");
@@ -30,25 +45,145 @@ void usage(char *msg) {
 		fprintf(stderr, "\n");
 		fprintf(stderr, "MESSAGE may be any string.\n");
 		fprintf(stderr, "\n");
+		fprintf(stderr, "The records of --format contain FROM and UNTIL in seconds since the Epoch, the seconds until FROM,\n");
+		fprintf(stderr, "the window ('since', 'hours', 'today' or 'week') and MESSAGE:\n");
+		fprintf(stderr, "  tsv     one tab-separated line per reminder, UNTIL is empty for single dates\n");
+		fprintf(stderr, "  jsonl   one JSON object per line, UNTIL is null for single dates\n");
+		fprintf(stderr, "  binary  int64 FROM, int64 UNTIL (INT64_MAX for single dates), int64 seconds, int32 window (1-4),\n");
+		fprintf(stderr, "          int32 length of MESSAGE, MESSAGE bytes; all in host byte order\n");
+		fprintf(stderr, "\n");
 	}
 	if (msg != NULL) {
 		fprintf(stderr, "Error: %s\n", msg);
 	}
 }
 
+/* The contents of a DATESFILE, to which the messages of reminders refer. */
+typedef struct datesfile_struct {
+	char *data;
+	long size;
+	int mapped;	// 1 if `data` is mmapped, 0 if it is malloced
+	string_pool messages;	// the messages which have been read from `data`
+} datesfile;
+
+/* Map the file `filename` (or read it, if it cannot be mapped, e.g. if it is "-" for standard input, or if `allow_mmap` is 0) into `file`. Returns 1 if it succeeded, and 0 (with `errno` set) if the file could not be read.
+A mapped file which is truncated while it is parsed raises SIGBUS, so files which are not trusted should be read. */
+int open_datesfile(const char *filename, datesfile *file, int allow_mmap) {
+	int fd = 0;
+	if (strcmp(filename, "-") != 0) {
+		fd = open(filename, O_RDONLY);
+		if (fd == -1)
+			return 0;
+	}
+	struct stat st;
+	if (fstat(fd, &st) == -1) {
+		int fstat_errno = errno;
+		if (fd != 0) close(fd);
+		errno = fstat_errno;
+		return 0;
+	}
+
+	file->mapped = 0;
+	if (allow_mmap && S_ISREG(st.st_mode) && st.st_size > 0) {
+		void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED) {
+			madvise(data, st.st_size, MADV_SEQUENTIAL);
+			file->data = (char*)data;
+			file->size = st.st_size;
+			file->mapped = 1;
+		}
+	}
+	if (!file->mapped) {
+		long size = 0;
+		long capacity = 0;
+		char *data = NULL;
+		while (1) {
+			if (size == capacity) {
+				capacity = capacity ? capacity * 2 : S_ISREG(st.st_mode) ? st.st_size + 1 : 65536;
+				data = (char*)realloc(data, capacity);
+				if (data == NULL) {
+					perror("realloc error");
+					exit(3);
+				}
+			}
+			ssize_t read_count = read(fd, &data[size], capacity - size);
+			if (read_count == -1) {
+				int read_errno = errno;
+				free(data);
+				if (fd != 0) close(fd);
+				errno = read_errno;
+				return 0;
+			}
+			if (read_count == 0) break;
+			size += read_count;
+		}
+		file->data = data;
+		file->size = size;
+	}
+
+	if (fd != 0 && close(fd) == -1) {
+		perror("close error");
+		exit(3);
+	}
+	string_pool_init(&file->messages);
+	return 1;
+}
+
+void close_datesfile(datesfile *file) {
+	if (file->mapped) {
+		if (munmap(file->data, file->size) == -1) {
+			perror("munmap error");
+			exit(3);
+		}
+	} else {
+		free(file->data);
+	}
+	string_pool_free(&file->messages);
+}
+
 typedef struct reminder_struct {
 	struct tm *from;
 	struct tm *until;
-	char *message;
+	long message_offset;	// position of the message in the datesfile
+	int message_length;
+	int message_id;	// ID in the pool of messages of the datesfile, or -1 if not read yet
 } reminder;
 
-void print_reminder(const reminder *reminder) {
-	printf("from=%s", asctime(reminder->from));
-	printf("until=%s", asctime(reminder->until));
-	printf("message=%s\n", reminder->message);
+/* Return the message of `reminder`. It is read from `file` only when it is needed for the first time, so that the messages of reminders which are never displayed cost nothing. */
+const char *reminder_message(reminder *reminder, datesfile *file) {
+	if (reminder->message_id == -1)
+		reminder->message_id = string_pool_intern(&file->messages, &file->data[reminder->message_offset], reminder->message_length);
+	return string_pool_get(&file->messages, reminder->message_id);
+}
+
+void print_reminder(FILE *stream, reminder *reminder, datesfile *file) {
+	fprintf(stream, "from=%s", asctime(reminder->from));
+	fprintf(stream, "until=%s", asctime(reminder->until));
+	fprintf(stream, "message=%s\n", reminder_message(reminder, file));
+}
+
+void free_reminders(reminder *reminders, int reminders_num) {
+	for (int i = 0; i < reminders_num; i++) {
+		free(reminders[i].from);
+		free(reminders[i].until);
+	}
+	free(reminders);
 }
 
-void parse_datesfile(FILE *stream, int *parsed_reminders_num, reminder **parsed_reminders) {
+typedef struct parse_error_struct {
+	int line;	// counted from 1
+	int column;	// counted from 1
+	char message[160];
+} parse_error;
+
+typedef struct parse_errors_struct {
+	int errors_num;
+	parse_error *errors;
+} parse_errors;
+
+/* Parse the reminders in `file`. Only their DATEs are parsed; of their messages, only the position in `file` is stored (see `reminder_message`).
+If `errors` is NULL, the program exits at the first error. Otherwise, every error is added to `errors` and the line containing it is skipped. */
+void parse_datesfile(const datesfile *file, int *parsed_reminders_num, reminder **parsed_reminders, parse_errors *errors) {
 	void* safe_malloc(int bytes) {
 		void* ptr = malloc(bytes);
 		if (ptr == NULL) {
@@ -62,7 +197,7 @@ void parse_datesfile(FILE *stream, int *parsed_reminders_num, reminder **parsed_
 	reminder *reminders = NULL;
 
 	// add `tm_date` to `reminders`.
-	void add_reminder(const struct tm * const tm_date_from, const struct tm * const tm_date_until, const char *message) {
+	void add_reminder(const struct tm * const tm_date_from, const struct tm * const tm_date_until, long message_offset, int message_length) {
 		reminders = (reminder*)realloc(reminders, sizeof(reminder) * (reminders_num + 1));
 		if (reminders == NULL) {
 			perror("realloc error");
@@ -72,26 +207,72 @@ void parse_datesfile(FILE *stream, int *parsed_reminders_num, reminder **parsed_
 		memcpy(reminders[reminders_num].from, tm_date_from, sizeof(struct tm));
 		reminders[reminders_num].until = (struct tm*)safe_malloc(sizeof(struct tm));
 		memcpy(reminders[reminders_num].until, tm_date_until, sizeof(struct tm));
-		int length = 0;
-		for (length = 0;; length++) { if (message[length] == '\0') { length++; break;}}
-		reminders[reminders_num].message = (char*)safe_malloc(sizeof(char) * length);
-		strcpy(reminders[reminders_num].message, message);
-		//print_reminder(&reminders[reminders_num]);
+		reminders[reminders_num].message_offset = message_offset;
+		reminders[reminders_num].message_length = message_length;
+		reminders[reminders_num].message_id = -1;
 		reminders_num++;
 	}
 	
+	// position of the current character and of the DATE which is currently parsed.
+	int line = 1;
+	long line_offset = 0;
+	int date_line = 1;
+	int date_column = 1;
+
+	/* Report the error `message` (followed by `detail`, if not NULL) at `error_line` and `error_column`. Exits with `exit_code` if errors are not collected. */
+	void report_error(int error_line, int error_column, const char *message, const char *detail, int exit_code) {
+		if (errors == NULL) {
+			if (detail == NULL) {
+				fprintf(stderr, "Error: %s\n", message);
+			} else {
+				usage(message);
+				fprintf(stderr, "%s\n", detail);
+			}
+			exit(exit_code);
+		}
+		errors->errors = (parse_error*)realloc(errors->errors, sizeof(parse_error) * (errors->errors_num + 1));
+		if (errors->errors == NULL) {
+			perror("realloc error");
+			exit(3);
+		}
+		parse_error *error = &errors->errors[errors->errors_num++];
+		error->line = error_line;
+		error->column = error_column;
+		// control characters of the DATEFILE are escaped, so that every error is printed on one line.
+		char text[sizeof(error->message)];
+		snprintf(text, sizeof(text), "%s%s%s", message, detail ? " " : "", detail ? detail : "");
+		const char *hex = "0123456789abcdef";
+		int n = 0;
+		for (int i = 0; text[i] != '\0'; i++) {
+			unsigned char ch = text[i];
+			int length = ch < 0x20 || ch == 0x7f ? 4 : 1;
+			if (n + length >= (int)sizeof(error->message)) break;
+			if (length == 1) {
+				error->message[n++] = ch;
+			} else {
+				error->message[n++] = '\\';
+				error->message[n++] = 'x';
+				error->message[n++] = hex[ch >> 4];
+				error->message[n++] = hex[ch & 0xf];
+			}
+		}
+		error->message[n] = '\0';
+	}
+
 	const int bufsize = 1024;
-	char buf[bufsize];
-	int field_num = 0;
 	int field_count = 0;
 	char field[bufsize];
+	char line_too_long[64];
+	snprintf(line_too_long, sizeof(line_too_long), "a line may only contain %i bytes", bufsize);
 
-	void buf_add_char(char ch) {
-		field[field_count++] = ch;
-		if (field_count > bufsize) {
-			fprintf(stderr, "Error: a line may only contain %i bytes\n", bufsize);
-			exit(4);
+	// returns 0 if the field is full.
+	int buf_add_char(char ch) {
+		if (field_count >= bufsize - 1) {
+			report_error(date_line, date_column, line_too_long, NULL, 4);
+			return 0;
 		}
+		field[field_count++] = ch;
+		return 1;
 	}
 
 	int char_is_whitespace(char ch) {
@@ -100,53 +281,75 @@ void parse_datesfile(FILE *stream, int *parsed_reminders_num, reminder **parsed_
 
 	struct tm tm_now;
 	get_tm_now(&tm_now);
-	void parse_date(char* field, struct tm *tm_date_ptr) {
+	// when collecting errors (possibly in many threads), times are compared without the time zone functions, which serialize the threads.
+	int (*diff)(const struct tm*, const struct tm*, double*) = errors != NULL ? tm_civil_diff : tm_diff_checked;
+	const char *not_convertible = "DATE cannot be converted to a time:";
+
+	// the parse functions return 0 if there was an error.
+	int parse_date(char* field, struct tm *tm_date_ptr) {
 		if (verbose_parsing) fprintf(stderr, "parsing DATE '%s'\n", field);
-		if (!parse_with_strptime(field, &tm_now, tm_date_ptr, NULL)) {
+		int parsed = parse_with_strptime_diff(field, &tm_now, tm_date_ptr, NULL, diff);
+		if (parsed == 0) {
 			const char *midnight = " 0:0:0";
-			strncat(field, midnight, bufsize-strlen(field));
+			strncat(field, midnight, bufsize-strlen(field)-1);
 			// try again
 			if (verbose_parsing) fprintf(stderr, "parsing DATE '%s'\n", field);
-			if (!parse_with_strptime(field, &tm_now, tm_date_ptr, NULL)) {
-				usage("wrong DATE format:");
-				fprintf(stderr, "%s\n", field);
-				exit(2);
+			parsed = parse_with_strptime_diff(field, &tm_now, tm_date_ptr, NULL, diff);
+			if (parsed == 0) {
+				report_error(date_line, date_column, "wrong DATE format:", field, 2);
+				return 0;
 			}
 		}
+		// when checking, also find DATEs which would make displaying the reminders fail.
+		double d;
+		if (parsed == -1 || (errors != NULL && !diff(tm_date_ptr, tm_date_ptr, &d))) {
+			report_error(date_line, date_column, not_convertible, field, 2);
+			return 0;
+		}
+		return 1;
 	}
 
-	void parse_date_range(char* field, struct tm* from, struct tm* until) {
+	int parse_date_range(char* field, struct tm* from, struct tm* until) {
 		char* dash = strchr(field, '~');
 		if (dash) {
 			if (verbose_parsing) fprintf(stderr, "parsing RANGE '%s'\n", field);
 			char *ptr = dash;
 			for (ptr=dash;; ptr--) {if (!char_is_whitespace(ptr[-1])) break;}
 			ptr[0] = '\0';
-			parse_date(field, from);
+			if (!parse_date(field, from)) return 0;
 			char* field2 = dash;
 			for (field2 = dash+1;; field2++) {if (!char_is_whitespace(*field2)) break;}
-			parse_date(field2, until);
+			if (!parse_date(field2, until)) return 0;
 			// check that `until` is after `from`
-			if (tm_diff(from, until) > 0) {
-				usage("FROM is later than UNTIL:");
-				fprintf(stderr, "%s = %s\n", field, field2);
-				exit(2);
+			double d;
+			if (!diff(from, until, &d)) {
+				char detail[2 * bufsize + 4];
+				snprintf(detail, sizeof(detail), "%s ~ %s", field, field2);
+				report_error(date_line, date_column, not_convertible, detail, 2);
+				return 0;
+			}
+			if (d > 0) {
+				char detail[2 * bufsize + 4];
+				snprintf(detail, sizeof(detail), "%s = %s", field, field2);
+				report_error(date_line, date_column, "FROM is later than UNTIL:", detail, 2);
+				return 0;
 			}
 		} else {
-			parse_date(field, from);
+			if (!parse_date(field, from)) return 0;
 			memcpy(until, from, sizeof(struct tm));
 			until->tm_sec--; // later this means until=infinity
 		}
+		return 1;
 	}
 
 	struct tm tm_date_from;
 	struct tm tm_date_until;
 	typedef enum {DATE, IGNORE, COMMENT, WHITESPACE, WHITE_TO_MESSAGE, MESSAGE} state_enum;
 	state_enum state = DATE; // ignore whitespace, wait for date
-	do {
-		int read_count = fread(buf, sizeof(char), bufsize, stream);
-
-		for (int i=0; i<read_count; i++) {
+	long message_offset = 0;
+	{
+		const char *buf = file->data;
+		for (long i=0; i<file->size; i++) {
 			char ch = buf[i];
 			//printf("state=%i ch=%i\n",state,ch);
 			if (state == IGNORE) {
@@ -169,43 +372,252 @@ void parse_datesfile(FILE *stream, int *parsed_reminders_num, reminder **parsed_
 				state = WHITESPACE; //whitespace
 			} else if (state == WHITESPACE && char_is_whitespace(ch)) {
 				// ignore whitespace
+			} else if ((state == DATE || state == WHITESPACE) && ch == '\n' && errors != NULL) {
+				// when collecting errors, a DATE does not continue on the next line.
+				if (field_count > 0) {
+					field[field_count] = '\0';
+					report_error(date_line, date_column, "missing '/' after DATE:", field, 2);
+				}
+				field_count = 0;
+				state = DATE;
 			} else if (state == DATE || (state == WHITESPACE && !char_is_whitespace(ch))) {
+				if (field_count == 0) {
+					date_line = line;
+					date_column = i - line_offset + 1;
+				}
+				int added = 1;
 				if (state == WHITESPACE) {
 					if (ch != '/')
-						field[field_count++] = ' ';
+						added = buf_add_char(' ');
 					state = DATE;
 				}
 				if (ch == '/') {
 					field[field_count++] = '\0';
-					parse_date_range(field, &tm_date_from, &tm_date_until);
 					field_count = 0;
-					state = WHITE_TO_MESSAGE; //skip to beginning of message
-				} else {
-					buf_add_char(ch);
+					if (parse_date_range(field, &tm_date_from, &tm_date_until)) {
+						state = WHITE_TO_MESSAGE; //skip to beginning of message
+					} else {
+						state = COMMENT; //skip the rest of the line
+					}
+				} else if (!added || !buf_add_char(ch)) {
+					field_count = 0;
+					state = COMMENT; //skip the rest of the line
 				}
 			} else if (state == WHITE_TO_MESSAGE && char_is_whitespace(ch)) {
 				// skip whitespace
 			} else if (state == MESSAGE || (state == WHITE_TO_MESSAGE && !char_is_whitespace(ch))) {
-				state = MESSAGE;
+				if (state == WHITE_TO_MESSAGE) {
+					message_offset = i;
+					state = MESSAGE;
+				}
 				if (ch == '\n') {
-					field[field_count++] = '\0';
-					add_reminder(&tm_date_from, &tm_date_until, field);
-					field_count = 0;
+					add_reminder(&tm_date_from, &tm_date_until, message_offset, i - message_offset);
 					state = IGNORE;
-				} else {
-					buf_add_char(ch);
+				} else if (i - message_offset >= bufsize) {
+					report_error(line, message_offset - line_offset + 1, line_too_long, NULL, 4);
+					state = COMMENT; //skip the rest of the line
 				}
 			} else {
 				fprintf(stderr, "internal error: state %i unknown!\n", state);
 				exit(4);
 			}
+			if (ch == '\n') {
+				line++;
+				line_offset = i + 1;
+			}
 		}
-	} while (!feof(stream));
+	}
+	// an unfinished last line is ignored, which is an error when checking.
+	if (errors != NULL) {
+		if ((state == DATE || state == WHITESPACE) && field_count > 0) {
+			field[field_count] = '\0';
+			report_error(date_line, date_column, "missing '/' after DATE:", field, 2);
+		} else if (state == WHITE_TO_MESSAGE || state == MESSAGE) {
+			report_error(date_line, date_column, "missing newline at the end of the reminder", NULL, 2);
+		}
+	}
 
 	*parsed_reminders_num = reminders_num;
 	*parsed_reminders = reminders;
 }
 
+const int hours_3 = 60*60*3;
+const int day = 24*60*60;
+const int day_7 = 24*60*60*7;
+
+typedef enum {WINDOW_NONE, WINDOW_SINCE, WINDOW_HOURS, WINDOW_TODAY, WINDOW_WEEK} window_enum;
+const char *window_names[] = {"none", "since", "hours", "today", "week"};
+
+/* Return the window in which a reminder starting in `seconds` and ending in `seconds_until` is displayed, or WINDOW_NONE if it is not displayed at all. */
+window_enum reminder_window(double seconds, double seconds_until) {
+	if (seconds < -day || seconds_until < day_7) return WINDOW_NONE;
+	if (seconds < 0) return WINDOW_SINCE;
+	if (seconds < hours_3) return WINDOW_HOURS;
+	if (seconds < day) return WINDOW_TODAY;
+	if (seconds < day_7) return WINDOW_WEEK;
+	return WINDOW_NONE;
+}
+
+typedef enum {FORMAT_TEXT, FORMAT_TSV, FORMAT_JSONL, FORMAT_BINARY} format_enum;
+
+/* Output buffer which is handed to stdio only when it is full, so that adding a field is a plain memory copy. */
+typedef struct outbuf_struct {
+	FILE *stream;
+	int count;
+	char data[1<<16];
+} outbuf;
+
+void outbuf_flush(outbuf *out) {
+	if (fwrite(out->data, sizeof(char), out->count, out->stream) != (size_t)out->count) {
+		perror("fwrite error");
+		exit(3);
+	}
+	out->count = 0;
+}
+
+// make room for `bytes` more bytes in `out`.
+void outbuf_reserve(outbuf *out, int bytes) {
+	if (out->count + bytes > (int)sizeof(out->data))
+		outbuf_flush(out);
+}
+
+void outbuf_add_char(outbuf *out, char ch) {
+	outbuf_reserve(out, 1);
+	out->data[out->count++] = ch;
+}
+
+void outbuf_add_bytes(outbuf *out, const void *bytes, int length) {
+	outbuf_reserve(out, length);
+	memcpy(&out->data[out->count], bytes, length);
+	out->count += length;
+}
+
+void outbuf_add_string(outbuf *out, const char *s) {
+	outbuf_add_bytes(out, s, strlen(s));
+}
+
+void outbuf_add_int(outbuf *out, long long number) {
+	char digits[24];
+	int n = 0;
+	unsigned long long u = number < 0 ? -(unsigned long long)number : (unsigned long long)number;
+	do {
+		digits[n++] = '0' + u % 10;
+		u /= 10;
+	} while (u != 0);
+	outbuf_reserve(out, n + 1);
+	if (number < 0)
+		out->data[out->count++] = '-';
+	while (n > 0)
+		out->data[out->count++] = digits[--n];
+}
+
+/* Add `length` bytes of `message` to `out`, escaped for a TSV field or, if `json` is set, for the inside of a JSON string. */
+void outbuf_add_escaped(outbuf *out, const char *message, int length, int json) {
+	const char *hex = "0123456789abcdef";
+	outbuf_reserve(out, length * 6);
+	char *dst = &out->data[out->count];
+	for (int i = 0; i < length; i++) {
+		unsigned char ch = message[i];
+		if (ch == '\\') {
+			*dst++ = '\\'; *dst++ = '\\';
+		} else if (ch == '\t') {
+			*dst++ = '\\'; *dst++ = 't';
+		} else if (ch == '\r') {
+			*dst++ = '\\'; *dst++ = 'r';
+		} else if (ch == '\n') {
+			*dst++ = '\\'; *dst++ = 'n';
+		} else if (json && ch == '"') {
+			*dst++ = '\\'; *dst++ = '"';
+		} else if (json && ch < 0x20) {
+			*dst++ = '\\'; *dst++ = 'u'; *dst++ = '0'; *dst++ = '0';
+			*dst++ = hex[ch >> 4]; *dst++ = hex[ch & 0xf];
+		} else {
+			*dst++ = ch;
+		}
+	}
+	out->count = dst - out->data;
+}
+
+/* Return the number of seconds until the line of a reminder starting in `seconds` and ending in `seconds_until` changes next, i.e. when it enters or leaves a window or when its displayed minutes, hours or days change. */
+double reminder_next_change(double seconds, double seconds_until) {
+	// reminders which have left the windows never come back.
+	if (seconds < -day || seconds_until < day_7) return INFINITY;
+
+	// the edges of the windows are crossed when `seconds` drops below them.
+	double next = INFINITY;
+	const double edges[] = {day_7, day, hours_3, 0, -day};
+	for (int i = 0; i < 5; i++) {
+		if (seconds >= edges[i]) next = fmin(next, seconds - edges[i]);
+	}
+	if (reminder_window(seconds, seconds_until) == WINDOW_NONE) return next;
+
+	if (seconds_until != INFINITY) next = fmin(next, seconds_until - day_7);
+	// minutes are displayed since FROM, hours within 24 hours and days within a week.
+	double unit = seconds < 0 ? 60 : seconds < day ? 60*60 : day;
+	if (seconds > 0) {
+		next = fmin(next, seconds - floor(seconds / unit) * unit);
+	} else {
+		next = fmin(next, (floor(-seconds / unit) + 1) * unit + seconds);
+	}
+	return next;
+}
+
+/* Print the displayed reminders as records in `format` (see usage), in one pass through an `outbuf`. */
+void print_reminders_formatted(FILE *stream, format_enum format, reminder *reminders, int reminders_num, datesfile *file) {
+	outbuf out;
+	out.stream = stream;
+	out.count = 0;
+
+	time_t now = time(NULL);
+	for (int i = 0; i < reminders_num; i++) {
+		time_t from = tm_to_time(reminders[i].from);
+		time_t until = tm_to_time(reminders[i].until);
+		int has_until = until > from;
+		double seconds = difftime(from, now);
+		double seconds_until = has_until ? difftime(until, now) : INFINITY;
+		window_enum window = reminder_window(seconds, seconds_until);
+		if (window == WINDOW_NONE) continue;
+
+		const char *message = reminder_message(&reminders[i], file);
+		int length = reminders[i].message_length;
+		if (format == FORMAT_TSV) {
+			outbuf_add_int(&out, from);
+			outbuf_add_char(&out, '\t');
+			if (has_until)
+				outbuf_add_int(&out, until);
+			outbuf_add_char(&out, '\t');
+			outbuf_add_int(&out, (long long)seconds);
+			outbuf_add_char(&out, '\t');
+			outbuf_add_string(&out, window_names[window]);
+			outbuf_add_char(&out, '\t');
+			outbuf_add_escaped(&out, message, length, 0);
+			outbuf_add_char(&out, '\n');
+		} else if (format == FORMAT_JSONL) {
+			outbuf_add_string(&out, "{\"from\":");
+			outbuf_add_int(&out, from);
+			outbuf_add_string(&out, ",\"until\":");
+			if (has_until)
+				outbuf_add_int(&out, until);
+			else
+				outbuf_add_string(&out, "null");
+			outbuf_add_string(&out, ",\"seconds\":");
+			outbuf_add_int(&out, (long long)seconds);
+			outbuf_add_string(&out, ",\"window\":\"");
+			outbuf_add_string(&out, window_names[window]);
+			outbuf_add_string(&out, "\",\"message\":\"");
+			outbuf_add_escaped(&out, message, length, 1);
+			outbuf_add_string(&out, "\"}\n");
+		} else if (format == FORMAT_BINARY) {
+			int64_t fields[3] = {from, has_until ? until : INT64_MAX, (int64_t)seconds};
+			int32_t fields2[2] = {window, length};
+			outbuf_add_bytes(&out, fields, sizeof(fields));
+			outbuf_add_bytes(&out, fields2, sizeof(fields2));
+			outbuf_add_bytes(&out, message, length);
+		}
+	}
+	outbuf_flush(&out);
+}
+
 #define ANSI_COLOR_RED     "\x1b[31m"
 #define ANSI_COLOR_GREEN   "\x1b[32m"
 #define ANSI_COLOR_YELLOW  "\x1b[33m"
@@ -214,6 +626,93 @@ void parse_datesfile(FILE *stream, int *parsed_reminders_num, reminder **parsed_
 #define ANSI_COLOR_CYAN    "\x1b[36m"
 #define ANSI_COLOR_RESET   "\x1b[0m"
 
+typedef struct check_job_struct {
+	const char *filename;
+	int open_errno;	// errno if the file could not be read, 0 otherwise
+	int reminders_num;
+	parse_errors errors;
+} check_job;
+
+typedef struct check_jobs_struct {
+	check_job *jobs;
+	int jobs_num;
+	int next_job;	// the next job to be taken by a thread
+} check_jobs;
+
+/* Check jobs of `arg` (a `check_jobs`) until none are left. */
+void *check_thread(void *arg) {
+	check_jobs *jobs = (check_jobs*)arg;
+	while (1) {
+		int j = __sync_fetch_and_add(&jobs->next_job, 1);
+		if (j >= jobs->jobs_num) break;
+		check_job *job = &jobs->jobs[j];
+		datesfile file;
+		// the checked files may be changed meanwhile, which must not crash the other threads.
+		if (!open_datesfile(job->filename, &file, 0)) {
+			job->open_errno = errno;
+			continue;
+		}
+		reminder *reminders;
+		parse_datesfile(&file, &job->reminders_num, &reminders, &job->errors);
+		free_reminders(reminders, job->reminders_num);
+		close_datesfile(&file);
+	}
+	return NULL;
+}
+
+/* Check the DATESFILEs `filenames` with one thread per CPU, and print all errors in the order of `filenames` followed by a summary. Returns 0 if all files are valid and 2 otherwise. */
+int check_datesfiles(const char **filenames, int filenames_num) {
+	check_jobs jobs;
+	jobs.jobs = (check_job*)calloc(filenames_num, sizeof(check_job));
+	if (jobs.jobs == NULL) {
+		perror("calloc error");
+		exit(3);
+	}
+	jobs.jobs_num = filenames_num;
+	jobs.next_job = 0;
+	for (int j = 0; j < filenames_num; j++) {
+		jobs.jobs[j].filename = filenames[j];
+	}
+
+	long threads_num = sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads_num < 1) threads_num = 1;
+	if (threads_num > filenames_num) threads_num = filenames_num;
+	pthread_t threads[threads_num];
+	for (int t = 0; t < threads_num; t++) {
+		int err = pthread_create(&threads[t], NULL, check_thread, &jobs);
+		if (err != 0) {
+			fprintf(stderr, "pthread_create error: %s\n", strerror(err));
+			exit(3);
+		}
+	}
+	for (int t = 0; t < threads_num; t++) {
+		pthread_join(threads[t], NULL);
+	}
+
+	int reminders_num = 0;
+	int errors_num = 0;
+	int invalid_files_num = 0;
+	for (int j = 0; j < filenames_num; j++) {
+		check_job *job = &jobs.jobs[j];
+		if (job->open_errno != 0) {
+			printf("%s: %s\n", job->filename, strerror(job->open_errno));
+			errors_num++;
+		}
+		for (int e = 0; e < job->errors.errors_num; e++) {
+			parse_error *error = &job->errors.errors[e];
+			printf("%s:%i:%i: %s\n", job->filename, error->line, error->column, error->message);
+		}
+		if (job->open_errno != 0 || job->errors.errors_num > 0)
+			invalid_files_num++;
+		errors_num += job->errors.errors_num;
+		reminders_num += job->reminders_num;
+		free(job->errors.errors);
+	}
+	printf("%i files with %i reminders checked: %i errors in %i files\n", filenames_num, reminders_num, errors_num, invalid_files_num);
+	free(jobs.jobs);
+	return invalid_files_num > 0 ? 2 : 0;
+}
+
 int main(int argc, const char **argv) {
 	if (argc < 2) {
 		usage("Must specify an input file");
@@ -224,10 +723,15 @@ int main(int argc, const char **argv) {
 	int colors = 0;
 	int verbose = 0;
 	int debug = 0;
+	format_enum format = FORMAT_TEXT;
+	int watch = 0;
+	int check = 0;
 	char *filename;
+	const char **filenames = (const char**)malloc(sizeof(char*) * argc);
+	int filenames_num = 0;
 	{
 		int no_opts = 0;
-		for (int i=0; i<argc; i++) {
+		for (int i=1; i<argc; i++) {
 			const char *arg = argv[i];
 			if (strcmp(arg, "--") == 0) {
 				no_opts = 1;
@@ -246,8 +750,26 @@ int main(int argc, const char **argv) {
 			} else if (strcmp(arg, "-h") == 0) {
 				usage(NULL);
 				exit(0);
+			} else if (strcmp(arg, "--check") == 0) {
+				check = 1;
+			} else if (strcmp(arg, "--watch") == 0) {
+				watch = 1;
+			} else if (strncmp(arg, "--format=", 9) == 0) {
+				const char *name = &arg[9];
+				if (strcmp(name, "tsv") == 0) {
+					format = FORMAT_TSV;
+				} else if (strcmp(name, "jsonl") == 0) {
+					format = FORMAT_JSONL;
+				} else if (strcmp(name, "binary") == 0) {
+					format = FORMAT_BINARY;
+				} else {
+					usage(NULL);
+					fprintf(stderr, "Unknown format '%s'\n", name);
+					exit(1);
+				}
 			} else if (arg[0] != '-' || no_opts) {
 				filename = (char*)arg;
+				filenames[filenames_num++] = arg;
 			} else {
 				usage(NULL);
 				fprintf(stderr, "Unknown option '%s'\n", arg);
@@ -255,31 +777,45 @@ int main(int argc, const char **argv) {
 			}
 		}
 	}
+	if (filenames_num == 0) {
+		usage("Must specify an input file");
+		exit(1);
+	}
+	if (check && watch) {
+		usage("--check cannot be combined with --watch");
+		exit(1);
+	}
+	if (check && format != FORMAT_TEXT) {
+		usage("--check cannot be combined with --format");
+		exit(1);
+	}
+	if (watch && format != FORMAT_TEXT) {
+		usage("--watch cannot be combined with --format");
+		exit(1);
+	}
+	if (check) {
+		exit(check_datesfiles(filenames, filenames_num));
+	}
 
 	int reminders_num;
 	reminder *reminders;
+	datesfile file;
+	struct timespec ts_parse_start, ts_parse_end;
 	{
-		FILE *stream;
-		if (strcmp(filename, "-") == 0) {
-			stream = stdin;
-		} else {
-			stream = fopen(filename, "r");
-			if (stream == NULL) {
-				perror("fopen error");
-				exit(3);
-			}
-		}
-		parse_datesfile(stream, &reminders_num, &reminders);
-		if (strcmp(filename, "-") != 0) {
-			if (!fclose(stream) == -1) {
-				perror("fclose error");
-				exit(3);
-			}
+		if (!open_datesfile(filename, &file, 1)) {
+			perror(filename);
+			exit(3);
 		}
+		clock_gettime(CLOCK_MONOTONIC, &ts_parse_start);
+		parse_datesfile(&file, &reminders_num, &reminders, NULL);
+		clock_gettime(CLOCK_MONOTONIC, &ts_parse_end);
 	}
 
-	if (debug)
-		printf("Number of reminders: %i\n", reminders_num);
+	if (debug) {
+		double parse_seconds = (ts_parse_end.tv_sec - ts_parse_start.tv_sec) + (ts_parse_end.tv_nsec - ts_parse_start.tv_nsec) / 1e9;
+		fprintf(stderr, "Number of reminders: %i\n", reminders_num);
+		fprintf(stderr, "Parsing took %f seconds (%.0f reminders per second)\n", parse_seconds, reminders_num / parse_seconds);
+	}
 
 	int compare_reminders_tm(const void *r1p, const void *r2p) {
 		const reminder *r1 = (const reminder*) r1p;
@@ -289,6 +825,12 @@ int main(int argc, const char **argv) {
 	if (sorted)
 		qsort(reminders, reminders_num, sizeof(reminder), compare_reminders_tm);
 
+	if (format != FORMAT_TEXT) {
+		print_reminders_formatted(stdout, format, reminders, reminders_num, &file);
+		close_datesfile(&file);
+		return 0;
+	}
+
 	const char *color_red = colors?ANSI_COLOR_RED:"'";
 	const char *color_green = colors?ANSI_COLOR_GREEN:"'";
 	const char *color_yellow = colors?ANSI_COLOR_YELLOW:"'";
@@ -297,115 +839,215 @@ int main(int argc, const char **argv) {
 	const char *color_cyan = colors?ANSI_COLOR_CYAN:"'";
 	const char *color_reset = colors?ANSI_COLOR_RESET:"'";
 
-	int first_start = 1;
-	int first_hours = 1;
-	int first_today = 1;
-	int first_week = 1;
-	for (int i = 0; i < reminders_num; i++) {
-		double seconds = tm_diff_to_now_seconds(reminders[i].from);
-		double seconds_until;
-		if (tm_diff(reminders[i].until, reminders[i].from) > 0) {
-			seconds_until = tm_diff_to_now_seconds(reminders[i].until);
-		} else {
-			seconds_until = INFINITY;
-		}
+	/* Print the reminders displayed at `tv_now` to `out`. Returns the number of seconds after `tv_now` at which the output changes next. */
+	double render_reminders(FILE *out, const struct timeval *tv_now) {
+		double next_change = INFINITY;
+		int first_start = 1;
+		int first_hours = 1;
+		int first_today = 1;
+		int first_week = 1;
+		for (int i = 0; i < reminders_num; i++) {
+			double seconds = tm_diff_seconds(reminders[i].from, tv_now);
+			double seconds_until;
+			if (tm_diff(reminders[i].until, reminders[i].from) > 0) {
+				seconds_until = tm_diff_seconds(reminders[i].until, tv_now);
+			} else {
+				seconds_until = INFINITY;
+			}
 
-		if (debug) {
-			printf("seconds=%f seconds_until=%f\n", seconds, seconds_until);
-			print_reminder(&reminders[i]);
-		}
+			if (debug) {
+				// stderr, since stdout may be the output of --watch.
+				fprintf(stderr, "seconds=%f seconds_until=%f\n", seconds, seconds_until);
+				print_reminder(stderr, &reminders[i], &file);
+			}
 
-		char *message = reminders[i].message;
-		int d_rem = (int)seconds / (60*60*24);
-		int d_int = (int)ceil(seconds / (60*60*24));
-		int h_rem = ((int)seconds % (60*60*24)) / (60*60);
-		int h_int = (int)ceil((int)seconds % (60*60*24)) / (60*60);
-		int m_rem = ((int)seconds % (60*60)) / 60;
-		int m_int = (int)ceil((int)seconds % (60*60)) / 60;
+			int d_rem = (int)seconds / (60*60*24);
+			int d_int = (int)ceil(seconds / (60*60*24));
+			int h_rem = ((int)seconds % (60*60*24)) / (60*60);
+			int h_int = (int)ceil((int)seconds % (60*60*24)) / (60*60);
+			int m_rem = ((int)seconds % (60*60)) / 60;
+			int m_int = (int)ceil((int)seconds % (60*60)) / 60;
 
-		const int hours_3 = 60*60*3;
-		const int day = 24*60*60;
-		const int day_7 = day*7;
+			next_change = fmin(next_change, reminder_next_change(seconds, seconds_until));
 
-		// do nothing
-		if (seconds < -day || seconds_until < day_7) continue;
+			// do nothing
+			if (reminder_window(seconds, seconds_until) == WINDOW_NONE) continue;
 
-		if (verbose > 0) {
-			if (seconds < 0) {
-				first_hours = 1; first_today = 1; first_week = 1;
-				if (first_start && verbose > 0) {
-					printf("Today:\n");
-					first_start = 0;
+			const char *message = reminder_message(&reminders[i], &file);
+
+			if (verbose > 0) {
+				if (seconds < 0) {
+					first_hours = 1; first_today = 1; first_week = 1;
+					if (first_start && verbose > 0) {
+						fprintf(out, "Today:\n");
+						first_start = 0;
+					}
+				} else if (seconds < hours_3) {
+					first_start = 1; first_today = 1; first_week = 1;
+					if (first_hours && verbose > 0) {
+						fprintf(out, "Within 3 hours:\n");
+						first_hours = 0;
+					}
+				} else if (seconds < day) {
+					first_start = 1; first_hours = 1; first_week = 1;
+					if (first_today && verbose > 0) {
+						fprintf(out, "Within 24 hours:\n");
+						first_today = 0;
+					}
+				} else if (seconds < day_7) {
+					first_start = 1; first_hours = 1; first_today = 1;
+					if (first_week && verbose) {
+						fprintf(out, "Within a week:\n");
+						first_week = 0;
+					}
 				}
-			} else if (seconds < hours_3) {
-				first_start = 1; first_today = 1; first_week = 1;
-				if (first_hours && verbose > 0) {
-					printf("Within 3 hours:\n");
-					first_hours = 0;
+			}
+				
+		
+			if (seconds < 0 && seconds < hours_3) {
+				if (verbose < -2) {
+					fprintf(out, "%02i%02i", h_rem, m_rem);
+				} else if (verbose == -2) {
+					fprintf(out, "%2i:%2i", h_rem, m_rem);
+				} else if (verbose == -1) {
+					fprintf(out, "%2ih %2im", h_rem, m_rem);
+				} else if (verbose >= 0) {
+					fprintf(out, "%2i hours %2i minutes", h_rem, m_rem);
 				}
 			} else if (seconds < day) {
-				first_start = 1; first_hours = 1; first_week = 1;
-				if (first_today && verbose > 0) {
-					printf("Within 24 hours:\n");
-					first_today = 0;
+				if (verbose < -2) {
+					fprintf(out, "%02i", h_int);
+				} else if (verbose == -2 || verbose == -1) {
+					fprintf(out, "%2ih", h_int);
+				} else if (verbose >= 0) {
+					fprintf(out, "%2i hours", h_int);
 				}
 			} else if (seconds < day_7) {
-				first_start = 1; first_hours = 1; first_today = 1;
-				if (first_week && verbose) {
-					printf("Within a week:\n");
-					first_week = 0;
+				if (verbose < -2) {
+					fprintf(out, "%i", d_int);
+				} else if (verbose == -2 || verbose == -1) {
+					fprintf(out, "%id", d_int);
+				} else  if (verbose >= 0) {
+					fprintf(out, "%i days", d_int);
 				}
 			}
-		}
-				
+
+			if (seconds < 0) {
+				fprintf(out, " since");
+			} else if (seconds < day_7) {
+				fprintf(out, " until");
+			}
 		
-		if (seconds < 0 && seconds < hours_3) {
-			if (verbose < -2) {
-				printf("%02i%02i", h_rem, m_rem);
-			} else if (verbose == -2) {
-				printf("%2i:%2i", h_rem, m_rem);
-			} else if (verbose == -1) {
-				printf("%2ih %2im", h_rem, m_rem);
-			} else if (verbose >= 0) {
-				printf("%2i hours %2i minutes", h_rem, m_rem);
+			if (seconds < 0) {
+				fprintf(out, " %s%s%s\n", color_magenta, message, color_reset);
+			} else if (seconds < hours_3) {
+				fprintf(out, " %s%s%s\n", color_cyan, message, color_reset);
+			} else if (seconds < day) {
+				fprintf(out, " %s%s%s\n", color_green, message, color_reset);
+			} else if (seconds < day_7) {
+				char *date = asctime(reminders[i].from);
+				if (date[strlen(date)-1] == '\n') {
+					date[strlen(date)-1] = '\0';
+				}
+				fprintf(out, " %s%s / %s%s\n", color_red, date, message, color_reset);
 			}
-		} else if (seconds < day) {
-			if (verbose < -2) {
-				printf("%02i", h_int);
-			} else if (verbose == -2 || verbose == -1) {
-				printf("%2ih", h_int);
-			} else if (verbose >= 0) {
-				printf("%2i hours", h_int);
+		}
+
+		return next_change;
+	}
+
+	struct timeval tv_now;
+	if (gettimeofday(&tv_now, NULL) == -1) {
+		perror("gettimeofday error");
+		exit(2);
+	}
+	if (!watch) {
+		render_reminders(stdout, &tv_now);
+	} else {
+		// the lines of the previous output
+		char *last_output = NULL;
+		char **last_lines = NULL;
+		int last_lines_num = 0;
+		while (1) {
+			char *output;
+			size_t output_size;
+			FILE *out = open_memstream(&output, &output_size);
+			if (out == NULL) {
+				perror("open_memstream error");
+				exit(3);
 			}
-		} else if (seconds < day_7) {
-			if (verbose < -2) {
-				printf("%i", d_int);
-			} else if (verbose == -2 || verbose == -1) {
-				printf("%id", d_int);
-			} else  if (verbose >= 0) {
-				printf("%i days", d_int);
+			// the output is rendered for one point in time, after which the next change is counted.
+			if (gettimeofday(&tv_now, NULL) == -1) {
+				perror("gettimeofday error");
+				exit(2);
+			}
+			double next_change = render_reminders(out, &tv_now);
+			if (fclose(out) == EOF) {
+				perror("fclose error");
+				exit(3);
 			}
-		}
 
-		if (seconds < 0) {
-			printf(" since");
-		} else if (seconds < day_7) {
-			printf(" until");
-		}
-		
-		if (seconds < 0) {
-			printf(" %s%s%s\n", color_magenta, message, color_reset);
-		} else if (seconds < hours_3) {
-			printf(" %s%s%s\n", color_cyan, message, color_reset);
-		} else if (seconds < day) {
-			printf(" %s%s%s\n", color_green, message, color_reset);
-		} else if (seconds < day_7) {
-			char *date = asctime(reminders[i].from);
-			if (date[strlen(date)-1] == '\n') {
-				date[strlen(date)-1] = '\0';
+			// split `output` into `lines`.
+			int lines_num = 0;
+			for (size_t i = 0; i < output_size; i++) {
+				if (output[i] == '\n') lines_num++;
+			}
+			char **lines = (char**)malloc(sizeof(char*) * (lines_num + 1));
+			if (lines == NULL) {
+				perror("malloc error");
+				exit(3);
+			}
+			{
+				int line = 0;
+				char *line_start = output;
+				for (size_t i = 0; i < output_size; i++) {
+					if (output[i] == '\n') {
+						output[i] = '\0';
+						lines[line++] = line_start;
+						line_start = &output[i+1];
+					}
+				}
+			}
+
+			// print the lines which changed.
+			if (last_output == NULL || lines_num != last_lines_num) {
+				printf("=%i\n", lines_num);
+			} else {
+				for (int line = 0; line < lines_num; line++) {
+					if (strcmp(lines[line], last_lines[line]) != 0) {
+						printf("=%i\n", lines_num);
+						break;
+					}
+				}
+			}
+			for (int line = 0; line < lines_num; line++) {
+				if (line >= last_lines_num || strcmp(lines[line], last_lines[line]) != 0) {
+					printf("%i\t%s\n", line + 1, lines[line]);
+				}
+			}
+			fflush(stdout);
+
+			free(last_output);
+			free(last_lines);
+			last_output = output;
+			last_lines = lines;
+			last_lines_num = lines_num;
+
+			if (next_change == INFINITY)
+				break;
+			// sleep until just after the change.
+			struct timeval tv_next;
+			{
+				struct timeval tv_wait;
+				next_change += 0.001;
+				tv_wait.tv_sec = (time_t)floor(next_change);
+				tv_wait.tv_usec = (suseconds_t)((next_change - floor(next_change)) * 1000000);
+				timeradd(&tv_now, &tv_wait, &tv_next);
 			}
-			printf(" %s%s / %s%s\n", color_red, date, message, color_reset);
+			sleep_until(&tv_next);
 		}
 	}
-	
+	if (debug)
+		fprintf(stderr, "Number of messages read: %i (%li bytes in pool)\n", file.messages.strings_num, string_pool_bytes(&file.messages));
+	close_datesfile(&file);
 }
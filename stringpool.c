@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stringpool.h"
+
+void* safe_realloc(void *ptr, size_t bytes) {
+	ptr = realloc(ptr, bytes);
+	if (ptr == NULL) {
+		perror("realloc error");
+		exit(3);
+	}
+	return ptr;
+}
+
+void string_pool_init(string_pool *pool) {
+	pool->chars = NULL;
+	pool->chars_num = 0;
+	pool->chars_size = 0;
+	pool->offsets = NULL;
+	pool->strings_num = 0;
+	pool->strings_size = 0;
+	pool->table_size = 64;
+	pool->table = (int*)safe_realloc(NULL, sizeof(int) * pool->table_size);
+	for (int i = 0; i < pool->table_size; i++) pool->table[i] = -1;
+}
+
+void string_pool_free(string_pool *pool) {
+	free(pool->chars);
+	free(pool->offsets);
+	free(pool->table);
+}
+
+// FNV-1a
+unsigned int string_hash(const char *s, int length) {
+	unsigned int hash = 2166136261u;
+	for (int i = 0; i < length; i++) {
+		hash ^= (unsigned char)s[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/* Double the size of the hash table of `pool` and re-insert all IDs. */
+void string_pool_grow_table(string_pool *pool) {
+	free(pool->table);
+	pool->table_size *= 2;
+	pool->table = (int*)safe_realloc(NULL, sizeof(int) * pool->table_size);
+	for (int i = 0; i < pool->table_size; i++) pool->table[i] = -1;
+	for (int id = 0; id < pool->strings_num; id++) {
+		unsigned int slot = string_hash(string_pool_get(pool, id), string_pool_length(pool, id)) & (pool->table_size - 1);
+		while (pool->table[slot] != -1) slot = (slot + 1) & (pool->table_size - 1);
+		pool->table[slot] = id;
+	}
+}
+
+/* Return the ID of the first `length` bytes of `s`, adding them to `pool` if they are not yet in it. */
+int string_pool_intern(string_pool *pool, const char *s, int length) {
+	unsigned int slot = string_hash(s, length) & (pool->table_size - 1);
+	while (pool->table[slot] != -1) {
+		int id = pool->table[slot];
+		if (string_pool_length(pool, id) == length && memcmp(string_pool_get(pool, id), s, length) == 0)
+			return id;
+		slot = (slot + 1) & (pool->table_size - 1);
+	}
+
+	// not found: append `s` to `chars` and give it the next ID.
+	if (pool->chars_num + length + 1 > pool->chars_size) {
+		while (pool->chars_num + length + 1 > pool->chars_size)
+			pool->chars_size = pool->chars_size ? pool->chars_size * 2 : 4096;
+		pool->chars = (char*)safe_realloc(pool->chars, sizeof(char) * pool->chars_size);
+	}
+	// one more offset than strings, so that the length of the last string is known.
+	if (pool->strings_num + 2 > pool->strings_size) {
+		pool->strings_size = pool->strings_size ? pool->strings_size * 2 : 64;
+		pool->offsets = (int*)safe_realloc(pool->offsets, sizeof(int) * pool->strings_size);
+	}
+	int id = pool->strings_num++;
+	pool->offsets[id] = pool->chars_num;
+	memcpy(&pool->chars[pool->chars_num], s, length);
+	pool->chars[pool->chars_num + length] = '\0';
+	pool->chars_num += length + 1;
+	pool->offsets[id + 1] = pool->chars_num;
+	pool->table[slot] = id;
+
+	// keep the load factor of the table below 1/2.
+	if (pool->strings_num * 2 > pool->table_size)
+		string_pool_grow_table(pool);
+	return id;
+}
+
+const char *string_pool_get(const string_pool *pool, int id) {
+	return &pool->chars[pool->offsets[id]];
+}
+
+int string_pool_length(const string_pool *pool, int id) {
+	return pool->offsets[id + 1] - pool->offsets[id] - 1;
+}
+
+/* Return the number of bytes allocated by `pool`. */
+long string_pool_bytes(const string_pool *pool) {
+	return (long)pool->chars_size + sizeof(int) * ((long)pool->strings_size + pool->table_size);
+}
@@ -0,0 +1,18 @@
+/* A pool of interned strings: equal strings are stored once and identified by a small integer ID. */
+typedef struct string_pool_struct {
+	char *chars;	// all strings, each terminated by '\0'
+	int chars_num;
+	int chars_size;
+	int *offsets;	// offset in `chars` of the string with ID i
+	int strings_num;
+	int strings_size;
+	int *table;	// open-addressing hash table of IDs, -1 if empty
+	int table_size;
+} string_pool;
+
+void string_pool_init(string_pool *pool);
+void string_pool_free(string_pool *pool);
+int string_pool_intern(string_pool *pool, const char *s, int length);
+const char *string_pool_get(const string_pool *pool, int id); // valid until the next string_pool_intern
+int string_pool_length(const string_pool *pool, int id);
+long string_pool_bytes(const string_pool *pool);
@@ -8,6 +8,7 @@
 #include <time.h>
 #include <sys/time.h>
 #include <string.h>
+#include <errno.h>
 #include "timefunctions.h"
 
 // for debugging
@@ -37,24 +38,73 @@ int try_strptime(const char* s, const char* format, struct tm* tm, char** rest)
 	return 1;
 }
 
-/* Return the time difference between a and b in seconds. */
-double tm_diff(const struct tm* a, const struct tm* b) {
-	struct tm tmp_a;
-	memcpy(&tmp_a, a, sizeof(tmp_a));
-	time_t t_a = mktime(&tmp_a);
-	if (t_a == -1) {
+/* Set `t` to `tm` as seconds since the Epoch. Returns 0 if mktime cannot convert `tm`, and 1 otherwise. */
+int tm_to_time_checked(const struct tm* tm, time_t* t) {
+	struct tm tmp;
+	memcpy(&tmp, tm, sizeof(tmp));
+	*t = mktime(&tmp);
+	return *t != -1;
+}
+
+/* Return `tm` as seconds since the Epoch. */
+time_t tm_to_time(const struct tm* tm) {
+	time_t t;
+	if (!tm_to_time_checked(tm, &t)) {
 		perror("mktime error: maybe time too far into the future");
 		exit(2);
 	}
-	struct tm tmp_b;
-	memcpy(&tmp_b, b, sizeof(tmp_b));
-	time_t t_b = mktime(&tmp_b);
-	if (t_b == -1) {
+	return t;
+}
+
+/* Set `diff` to the time difference between a and b in seconds. Returns 0 if a or b cannot be converted by mktime, and 1 otherwise. */
+int tm_diff_checked(const struct tm* a, const struct tm* b, double* diff) {
+	time_t t_a, t_b;
+	if (!tm_to_time_checked(a, &t_a) || !tm_to_time_checked(b, &t_b))
+		return 0;
+	*diff = difftime(t_a, t_b);
+	return 1;
+}
+
+/* Return the time difference between a and b in seconds. */
+double tm_diff(const struct tm* a, const struct tm* b) {
+	double diff;
+	if (!tm_diff_checked(a, b, &diff)) {
 		perror("mktime error: maybe time too far into the future");
 		exit(2);
 	}
-	
-	return difftime(t_a, t_b);
+	return diff;
+}
+
+/* Return the wall clock time `tm` (which need not be normalized) as seconds since 1970-01-01 00:00:00 of the same time zone, computed from the calendar alone. */
+long long tm_civil_seconds(const struct tm* tm) {
+	// normalize the month, then count days like in the proleptic Gregorian calendar.
+	long long year = tm->tm_year + 1900LL + tm->tm_mon / 12;
+	int mon = tm->tm_mon % 12;
+	if (mon < 0) {
+		mon += 12;
+		year--;
+	}
+	if (mon < 2) year--;	// count years from March, so that leap days are at the end
+	long long era = (year >= 0 ? year : year - 399) / 400;
+	long long year_of_era = year - era * 400;
+	long long day_of_year = (153 * (mon < 2 ? mon + 10 : mon - 2) + 2) / 5;
+	long long day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+	long long days = era * 146097 + day_of_era - 719468 + tm->tm_mday - 1;
+	return ((days * 24 + tm->tm_hour) * 60 + tm->tm_min) * 60 + tm->tm_sec;
+}
+
+/* Like `tm_diff_checked`, but without mktime and therefore without the (locked) time zone functions of the C library, except where mktime could fail.
+Differences are in wall clock time, i.e. they ignore changes of the UTC offset (e.g. for daylight saving time) between a and b. */
+int tm_civil_diff(const struct tm* a, const struct tm* b, double* diff) {
+	long long s_a = tm_civil_seconds(a);
+	long long s_b = tm_civil_seconds(b);
+	// mktime only fails for the time_t -1 (one second before the Epoch), which is less than a day from the civil 0 in every time zone.
+	const long long day = 24*60*60;
+	time_t t;
+	if ((s_a > -2*day && s_a < 2*day && !tm_to_time_checked(a, &t)) || (s_b > -2*day && s_b < 2*day && !tm_to_time_checked(b, &t)))
+		return 0;
+	*diff = (double)(s_a - s_b);
+	return 1;
 }
 
 void get_tm_now(struct tm* tm_now) {
@@ -93,8 +143,9 @@ int try_localtime(const char* time, struct tm* tm, char** rest) {
 "%Y%m%d" (error if in the past)
 "@%s" (seconds since the Epoch 1970-01-01)
 Returns 1 if it succeeded, and in this case sets parsed_time.
-Returns 0 if parsing did not conform to one of the above formats. */
-int parse_with_strptime(char *time, const struct tm * const tm_now, struct tm* parsed_time, char** rest) {
+Returns 0 if parsing did not conform to one of the above formats.
+Returns -1 if `diff` (which compares times like `tm_diff_checked`) failed. */
+int parse_with_strptime_diff(char *time, const struct tm * const tm_now, struct tm* parsed_time, char** rest, int (*diff)(const struct tm*, const struct tm*, double*)) {
 	// TODO: Sometimes, when running "countdown 1:0:59", it wants to wait until 1:0:58, not 1:0:59.
 	
 	// init tm_stop
@@ -102,8 +153,10 @@ int parse_with_strptime(char *time, const struct tm * const tm_now, struct tm* p
 	memcpy(&tm_stop, tm_now, sizeof(tm_stop));
 	tm_stop.tm_sec = 0;
 	
+	double d;
 	if (try_strptime(time, "%H:%M", &tm_stop, rest) || try_strptime(time, "%H:%M:%S", &tm_stop, rest)) {
-		if (tm_diff(&tm_stop, tm_now) < 0) {
+		if (!diff(&tm_stop, tm_now, &d)) return -1;
+		if (d < 0) {
 			tm_stop.tm_mday += 1;	// tomorrow
 		}
 	} else if (try_strptime(time, "%A%n%H:%M", &tm_stop, rest) || try_strptime(time, "%A%n%H:%M:%S", &tm_stop, rest)) {	//I'm not sure %A sets the whole date, it might set only tm_wday, in which case mktime normalizes a non-matching tm_wday away.
@@ -113,7 +166,8 @@ int parse_with_strptime(char *time, const struct tm * const tm_now, struct tm* p
 			days_diff += 7;
 		tm_stop.tm_mday += days_diff;
 		// we still need to check if tm_stop is in the past, because tm_stop might be from today with a daytime before now.
-		if (tm_diff(&tm_stop, tm_now) < 0) {
+		if (!diff(&tm_stop, tm_now, &d)) return -1;
+		if (d < 0) {
 			tm_stop.tm_mday += 7;	// next week
 		}
 	} else if (try_strptime(time, "%Y-%m-%d%n%H:%M:%S", &tm_stop, rest)) {
@@ -134,8 +188,13 @@ int parse_with_strptime(char *time, const struct tm * const tm_now, struct tm* p
 	return 1;
 }
 
-/* Return how many seconds `tm_time` is in the future. */
-double tm_diff_to_now_seconds(const struct tm* tm_time) {
+/* `parse_with_strptime_diff` with mktime, where failing to convert a time counts as not conforming to a format. */
+int parse_with_strptime(char *time, const struct tm * const tm_now, struct tm* parsed_time, char** rest) {
+	return parse_with_strptime_diff(time, tm_now, parsed_time, rest, tm_diff_checked) == 1;
+}
+
+/* Return how many seconds `tm_time` is after `tv_now`. */
+double tm_diff_seconds(const struct tm* tm_time, const struct timeval* tv_now) {
 	// convert `tm_time` to `time_t` and then to `timeval`-structure `tv_stop`
 	struct timeval tv_stop;
 	{
@@ -152,21 +211,20 @@ double tm_diff_to_now_seconds(const struct tm* tm_time) {
 		tv_stop.tv_usec = 0;
 	}
 	
-	// compute difference between now and tv_stop
-	double waittime;
-	{
-		struct timeval tv_now;
-		if (gettimeofday(&tv_now, NULL) == -1) {
-			perror("gettimeofday error");
-			exit(2);
-		}
+	// compute difference between tv_now and tv_stop
+	struct timeval tv_diff;
+	timersub(&tv_stop, tv_now, &tv_diff);
+	return (double)tv_diff.tv_usec/1000000 + tv_diff.tv_sec;
+}
 
-		struct timeval tv_diff;
-		timersub(&tv_stop, &tv_now, &tv_diff);
-		waittime = (double)tv_diff.tv_usec/1000000 + tv_diff.tv_sec;
+/* Return how many seconds `tm_time` is in the future. */
+double tm_diff_to_now_seconds(const struct tm* tm_time) {
+	struct timeval tv_now;
+	if (gettimeofday(&tv_now, NULL) == -1) {
+		perror("gettimeofday error");
+		exit(2);
 	}
-
-	return waittime;
+	return tm_diff_seconds(tm_time, &tv_now);
 }
 
 /* Like `parse_with_strptime`, but with subsecond resolution. */
@@ -187,6 +245,21 @@ int parse_with_strptime_waittime(char *time, const struct tm * const tm_now, dou
 	return 1;
 }
 
+/* Sleep until the absolute (wall clock) time `tv`. Unlike sleeping for a duration, this does not drift if the sleep is interrupted or started late. */
+void sleep_until(const struct timeval* tv) {
+	struct timespec ts;
+	ts.tv_sec = tv->tv_sec;
+	ts.tv_nsec = tv->tv_usec * 1000;
+	int err;
+	while ((err = clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &ts, NULL)) == EINTR) {
+	}
+	if (err != 0) {
+		errno = err;
+		perror("clock_nanosleep error");
+		exit(2);
+	}
+}
+
 void usage_of_parse_with_strptime(FILE* stream) {
 	fprintf(stream, "7:4 or 07:04 (today or tomorrow, seconds=0)\n");
 	fprintf(stream, "7:4:59 (today or tomorrow)\n");
@@ -1,11 +1,20 @@
 #include <time.h>
+#include <sys/time.h>
 
 void print_tm(const struct tm* time);
 int compare_tm(const void *t1, const void *t2);
 int try_strptime(const char* s, const char* format, struct tm* tm, char** rest);
 double tm_diff(const struct tm* a, const struct tm* b);
+int tm_diff_checked(const struct tm* a, const struct tm* b, double* diff);
+time_t tm_to_time(const struct tm* tm);
+int tm_to_time_checked(const struct tm* tm, time_t* t);
+long long tm_civil_seconds(const struct tm* tm);
+int tm_civil_diff(const struct tm* a, const struct tm* b, double* diff);
 void get_tm_now(struct tm* tm_now);
+int parse_with_strptime_diff(char *time, const struct tm * const tm_now, struct tm* parsed_time, char** rest, int (*diff)(const struct tm*, const struct tm*, double*));
 int parse_with_strptime(char *time, const struct tm * const tm_now, struct tm* parsed_time, char** rest);
+double tm_diff_seconds(const struct tm* tm_time, const struct timeval* tv_now);
 double tm_diff_to_now_seconds(const struct tm* tm_time);
 int parse_with_strptime_waittime(char *time, const struct tm * const tm_now, double *waittime);
 void usage_of_parse_with_strptime(FILE* stream);
+void sleep_until(const struct timeval* tv);